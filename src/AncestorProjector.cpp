@@ -0,0 +1,154 @@
+/*
+ * This file is part of GloVeHd
+ *
+ * Copyright 2023 Observational Health Data Sciences and Informatics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANCESTORPROJECTOR_CPP_
+#define ANCESTORPROJECTOR_CPP_
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <Rcpp.h>
+#include "AncestorProjector.h"
+#include "ConceptAncestorMap.h"
+#include "ParallelFor.h"
+
+using namespace Rcpp;
+
+namespace ohdsi {
+namespace glovehd {
+
+AncestorProjector::AncestorProjector(const std::vector<int>& _i,
+                                     const std::vector<int>& _j,
+                                     const std::vector<double>& _x,
+                                     const std::vector<double>& _baseConceptIds,
+                                     const std::vector<double>& _conceptIds,
+                                     const DataFrame& _conceptAncestor,
+                                     const int _maxCores) :
+baseMatrix(CsrMatrix::fromTriplets(_i, _j, _x, _baseConceptIds.size())),
+baseToAncestors(),
+ancestorToBases(),
+conceptIds(_conceptIds),
+maxCores(_maxCores) {
+  std::unordered_map<int64_t, int> conceptIdToIndex;
+  for (unsigned int i = 0; i < _conceptIds.size(); i++) {
+    conceptIdToIndex[_conceptIds[i]] = i;
+  }
+  ConceptAncestorMap conceptAncestorMap(_conceptAncestor);
+  std::vector<int> baseIndices;
+  std::vector<int> ancestorIndices;
+  for (unsigned int i = 0; i < _baseConceptIds.size(); i++) {
+    const std::vector<int64_t>* ancestors = conceptAncestorMap.getAncestors((int64_t)_baseConceptIds[i]);
+    if (ancestors == NULL)
+      continue;
+    for (int64_t ancestorConceptId : *ancestors) {
+      std::unordered_map<int64_t, int>::iterator iterator = conceptIdToIndex.find(ancestorConceptId);
+      if (iterator != conceptIdToIndex.end()) {
+        baseIndices.push_back(i);
+        ancestorIndices.push_back(iterator->second);
+      }
+    }
+  }
+  // A is binary, so duplicate ancestor relationships must not be summed:
+  std::vector<double> ones(baseIndices.size(), 1);
+  baseToAncestors = CsrMatrix::fromTriplets(baseIndices, ancestorIndices, ones, _baseConceptIds.size());
+  std::fill(baseToAncestors.values.begin(), baseToAncestors.values.end(), 1);
+  ancestorToBases = CsrMatrix::fromTriplets(ancestorIndices, baseIndices, ones, _conceptIds.size());
+  std::fill(ancestorToBases.values.begin(), ancestorToBases.values.end(), 1);
+}
+
+CsrMatrix AncestorProjector::multiply(const CsrMatrix& left, const CsrMatrix& right, const int nColumns) {
+  // Row-by-row sparse product (Gustavson). Each thread computes a contiguous 
+  // range of rows using a dense accumulator, and the ranges are concatenated in
+  // thread order afterwards:
+  int64_t nRows = left.rowStarts.size() - 1;
+  std::vector<CsrMatrix> partials(maxCores);
+  parallelFor(maxCores, nRows, [&left, &right, &partials, nColumns](int thread, int64_t start, int64_t end) {
+    CsrMatrix& partial = partials[thread];
+    std::vector<double> accumulator(nColumns, 0);
+    std::vector<bool> isTouched(nColumns, false);
+    std::vector<int> touched;
+    partial.rowStarts.push_back(0);
+    for (int64_t row = start; row < end; row++) {
+      for (int64_t k = left.rowStarts[row]; k < left.rowStarts[row + 1]; k++) {
+        const int middle = left.columns[k];
+        const double value = left.values[k];
+        for (int64_t l = right.rowStarts[middle]; l < right.rowStarts[middle + 1]; l++) {
+          const int column = right.columns[l];
+          if (!isTouched[column]) {
+            isTouched[column] = true;
+            touched.push_back(column);
+          }
+          accumulator[column] += value * right.values[l];
+        }
+      }
+      std::sort(touched.begin(), touched.end());
+      for (int column : touched) {
+        partial.columns.push_back(column);
+        partial.values.push_back(accumulator[column]);
+        accumulator[column] = 0;
+        isTouched[column] = false;
+      }
+      touched.clear();
+      partial.rowStarts.push_back(partial.columns.size());
+    }
+  });
+  CsrMatrix result;
+  result.rowStarts.push_back(0);
+  for (CsrMatrix& partial : partials) {
+    int64_t offset = result.columns.size();
+    for (size_t r = 1; r < partial.rowStarts.size(); r++)
+      result.rowStarts.push_back(partial.rowStarts[r] + offset);
+    result.columns.insert(result.columns.end(), partial.columns.begin(), partial.columns.end());
+    result.values.insert(result.values.end(), partial.values.begin(), partial.values.end());
+    partial = CsrMatrix();
+  }
+  return result;
+}
+
+S4 AncestorProjector::projectMatrix() {
+  int nConcepts = conceptIds.size();
+  // C * A first, so the intermediate result has only one side rolled up:
+  CsrMatrix rolledUpColumns = multiply(baseMatrix, baseToAncestors, nConcepts);
+  CsrMatrix rolledUp = multiply(ancestorToBases, rolledUpColumns, nConcepts);
+  
+  size_t nnz = rolledUp.values.size();
+  IntegerVector I(nnz), J(nnz);
+  NumericVector X(nnz);
+  for (int row = 0; row < nConcepts; row++) {
+    for (int64_t k = rolledUp.rowStarts[row]; k < rolledUp.rowStarts[row + 1]; k++) {
+      I[k] = row;
+      J[k] = rolledUp.columns[k];
+      X[k] = rolledUp.values[k];
+    }
+  }
+  CharacterVector dimNames(nConcepts);
+  for (int i = 0; i < nConcepts; i++) {
+    dimNames[i] = std::to_string((int) conceptIds[i]);
+  }
+  S4 tripletMatrix("dgTMatrix");
+  tripletMatrix.slot("i") = I;
+  tripletMatrix.slot("j") = J;
+  tripletMatrix.slot("x") = X;
+  tripletMatrix.slot("Dim") = IntegerVector::create(nConcepts, nConcepts);
+  tripletMatrix.slot("Dimnames") = List::create(dimNames, dimNames);
+  return tripletMatrix;
+}
+}
+}
+
+#endif /* ANCESTORPROJECTOR_CPP_ */
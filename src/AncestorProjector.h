@@ -0,0 +1,61 @@
+/*
+ * This file is part of GloVeHd
+ *
+ * Copyright 2023 Observational Health Data Sciences and Informatics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANCESTORPROJECTOR_H_
+#define ANCESTORPROJECTOR_H_
+
+#include <Rcpp.h>
+#include <vector>
+#include "CsrMatrix.h"
+
+using namespace Rcpp;
+
+namespace ohdsi {
+namespace glovehd {
+
+// Rolls up a co-occurrence matrix C of verbatim (base) concepts to ancestor 
+// concepts by computing A' * C * A, where A is the base-concept-to-ancestor
+// matrix derived from the concept ancestor table. This avoids expanding every
+// event to all its ancestors before counting co-occurrences. Entry (a, b) sums
+// the co-occurrences of all pairs of descendants of a and b, so unlike the
+// expansion it grows with the number of co-occurring descendants of both.
+class AncestorProjector {
+public:
+  AncestorProjector(const std::vector<int>& _i,
+                    const std::vector<int>& _j,
+                    const std::vector<double>& _x,
+                    const std::vector<double>& _baseConceptIds,
+                    const std::vector<double>& _conceptIds,
+                    const DataFrame& _conceptAncestor,
+                    const int _maxCores);
+  S4 projectMatrix();
+private:
+  CsrMatrix multiply(const CsrMatrix& left, const CsrMatrix& right, const int nColumns);
+  
+  CsrMatrix baseMatrix;
+  // A, base concepts by concepts:
+  CsrMatrix baseToAncestors;
+  // A', concepts by base concepts:
+  CsrMatrix ancestorToBases;
+  std::vector<double> conceptIds;
+  int maxCores;
+};
+}
+}
+
+#endif /* ANCESTORPROJECTOR_H_ */
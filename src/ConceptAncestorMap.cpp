@@ -0,0 +1,54 @@
+/*
+ * This file is part of GloVeHd
+ *
+ * Copyright 2023 Observational Health Data Sciences and Informatics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CONCEPTANCESTORMAP_CPP_
+#define CONCEPTANCESTORMAP_CPP_
+
+#include <Rcpp.h>
+#include "ConceptAncestorMap.h"
+
+using namespace Rcpp;
+
+namespace ohdsi {
+namespace glovehd {
+
+ConceptAncestorMap::ConceptAncestorMap(const DataFrame& _conceptAncestor) :
+conceptToAncestors() {
+  if (_conceptAncestor.size() == 0)
+    return;
+  NumericVector ancestorConceptId = _conceptAncestor["ancestorConceptId"];
+  NumericVector descendantConceptId = _conceptAncestor["descendantConceptId"];
+  for (int i = 0; i < ancestorConceptId.size(); i++) {
+    conceptToAncestors[(int64_t)descendantConceptId[i]].push_back((int64_t)ancestorConceptId[i]);
+  }
+}
+
+bool ConceptAncestorMap::isEmpty() const {
+  return conceptToAncestors.empty();
+}
+
+const std::vector<int64_t>* ConceptAncestorMap::getAncestors(const int64_t conceptId) const {
+  std::unordered_map<int64_t, std::vector<int64_t>>::const_iterator iterator = conceptToAncestors.find(conceptId);
+  if (iterator == conceptToAncestors.end())
+    return NULL;
+  return &iterator->second;
+}
+}
+}
+
+#endif /* CONCEPTANCESTORMAP_CPP_ */
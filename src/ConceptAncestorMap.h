@@ -0,0 +1,46 @@
+/*
+ * This file is part of GloVeHd
+ *
+ * Copyright 2023 Observational Health Data Sciences and Informatics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CONCEPTANCESTORMAP_H_
+#define CONCEPTANCESTORMAP_H_
+
+#include <Rcpp.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace Rcpp;
+
+namespace ohdsi {
+namespace glovehd {
+
+// Maps each descendant concept ID to the concept IDs it rolls up to (including 
+// itself when the concept ancestor table contains the self-relationship). An
+// empty concept ancestor table means no roll-up.
+class ConceptAncestorMap {
+public:
+  ConceptAncestorMap(const DataFrame& _conceptAncestor);
+  bool isEmpty() const;
+  // Returns NULL if the concept has no ancestors:
+  const std::vector<int64_t>* getAncestors(const int64_t conceptId) const;
+private:
+  std::unordered_map<int64_t, std::vector<int64_t>> conceptToAncestors;
+};
+}
+}
+
+#endif /* CONCEPTANCESTORMAP_H_ */
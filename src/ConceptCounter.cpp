@@ -0,0 +1,99 @@
+/*
+ * This file is part of GloVeHd
+ *
+ * Copyright 2023 Observational Health Data Sciences and Informatics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CONCEPTCOUNTER_CPP_
+#define CONCEPTCOUNTER_CPP_
+
+#include <algorithm>
+#include <Rcpp.h>
+#include "ConceptCounter.h"
+
+using namespace Rcpp;
+
+namespace ohdsi {
+namespace glovehd {
+
+ConceptCounter::ConceptCounter(const List& _conceptData,
+                               const DataFrame& _conceptAncestor,
+                               const std::vector<double>& _conceptIds,
+                               const double _minCount,
+                               const int _maxVocabularySize) :
+conceptDataIterator(_conceptData, true),
+conceptAncestorMap(_conceptAncestor),
+vocabulary(),
+minCount(_minCount),
+maxVocabularySize(_maxVocabularySize),
+conceptIdToCount() {
+  for (double conceptId : _conceptIds)
+    vocabulary.insert((int64_t)conceptId);
+}
+
+void ConceptCounter::addCount(const int64_t conceptId) {
+  if (conceptAncestorMap.isEmpty()) {
+    conceptIdToCount[conceptId]++;
+  } else {
+    const std::vector<int64_t>* ancestors = conceptAncestorMap.getAncestors(conceptId);
+    if (ancestors != NULL) {
+      for (int64_t ancestorConceptId: *ancestors) {
+        conceptIdToCount[ancestorConceptId]++;
+      }
+    }
+  }
+}
+
+DataFrame ConceptCounter::countConcepts() {
+  // The number of distinct concepts is bounded by the vocabulary, so exact 
+  // counts fit in memory regardless of the number of records:
+  while (conceptDataIterator.hasNext()) {
+    List conceptDatas = conceptDataIterator.next();
+    NumericVector conceptIds = conceptDatas["conceptId"];
+    for (int i = 0; i < conceptIds.size(); i++) {
+      addCount((int64_t)conceptIds[i]);
+    }
+  }
+  std::vector<std::pair<int64_t, double>> counts;
+  counts.reserve(conceptIdToCount.size());
+  // Concepts outside the vocabulary (e.g. verbatim drugs that only roll up to 
+  // ingredients) must not take up slots of the maximum vocabulary size:
+  for (std::pair<const int64_t, double>& conceptIdAndCount : conceptIdToCount) {
+    if (conceptIdAndCount.second >= minCount && vocabulary.count(conceptIdAndCount.first) != 0)
+      counts.push_back(conceptIdAndCount);
+  }
+  // Sort by descending count, breaking ties by concept ID to be deterministic:
+  std::sort(counts.begin(), counts.end(), 
+            [](const std::pair<int64_t, double>& a, const std::pair<int64_t, double>& b) {
+              if (a.second == b.second)
+                return a.first < b.first;
+              else
+                return a.second > b.second;
+            });
+  if (maxVocabularySize > 0 && counts.size() > (size_t)maxVocabularySize)
+    counts.resize(maxVocabularySize);
+  
+  NumericVector conceptId(counts.size());
+  NumericVector conceptCount(counts.size());
+  for (size_t i = 0; i < counts.size(); i++) {
+    conceptId[i] = counts[i].first;
+    conceptCount[i] = counts[i].second;
+  }
+  return DataFrame::create(_["conceptId"] = conceptId, _["conceptCount"] = conceptCount);
+}
+}
+}
+
+#endif /* CONCEPTCOUNTER_CPP_ */
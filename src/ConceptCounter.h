@@ -0,0 +1,58 @@
+/*
+ * This file is part of GloVeHd
+ *
+ * Copyright 2023 Observational Health Data Sciences and Informatics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CONCEPTCOUNTER_H_
+#define CONCEPTCOUNTER_H_
+
+#include <Rcpp.h>
+#include <unordered_map>
+#include <unordered_set>
+#include "AndromedaTableIterator.h"
+#include "ConceptAncestorMap.h"
+
+using namespace Rcpp;
+
+namespace ohdsi {
+namespace glovehd {
+
+// Single streaming pass over the concept data counting the number of records 
+// per concept (after roll-up to ancestors), used to prune the vocabulary before
+// building the co-occurrence matrix. Only concepts in the vocabulary (conceptIds)
+// are considered when applying the thresholds.
+class ConceptCounter {
+public:
+  ConceptCounter(const List& _conceptData,
+                 const DataFrame& _conceptAncestor,
+                 const std::vector<double>& _conceptIds,
+                 const double _minCount,
+                 const int _maxVocabularySize);
+  DataFrame countConcepts();
+private:
+  void addCount(const int64_t conceptId);
+  
+  AndromedaTableIterator conceptDataIterator;
+  ConceptAncestorMap conceptAncestorMap;
+  std::unordered_set<int64_t> vocabulary;
+  double minCount;
+  int maxVocabularySize;
+  std::unordered_map<int64_t, double> conceptIdToCount;
+};
+}
+}
+
+#endif /* CONCEPTCOUNTER_H_ */
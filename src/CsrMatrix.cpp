@@ -0,0 +1,66 @@
+/*
+ * This file is part of GloVeHd
+ *
+ * Copyright 2023 Observational Health Data Sciences and Informatics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CSRMATRIX_CPP_
+#define CSRMATRIX_CPP_
+
+#include <algorithm>
+#include "CsrMatrix.h"
+
+namespace ohdsi {
+namespace glovehd {
+
+CsrMatrix CsrMatrix::fromTriplets(const std::vector<int>& rows, 
+                                  const std::vector<int>& columns, 
+                                  const std::vector<double>& values, 
+                                  const int nRows) {
+  CsrMatrix csr;
+  csr.rowStarts.assign(nRows + 1, 0);
+  for (int row : rows)
+    csr.rowStarts[row + 1]++;
+  for (int row = 0; row < nRows; row++)
+    csr.rowStarts[row + 1] += csr.rowStarts[row];
+  std::vector<std::pair<int, double>> entries(rows.size());
+  std::vector<int64_t> cursors(csr.rowStarts.begin(), csr.rowStarts.end() - 1);
+  for (size_t k = 0; k < rows.size(); k++)
+    entries[cursors[rows[k]]++] = std::make_pair(columns[k], values[k]);
+  
+  csr.columns.reserve(entries.size());
+  csr.values.reserve(entries.size());
+  int64_t start = 0;
+  for (int row = 0; row < nRows; row++) {
+    int64_t end = csr.rowStarts[row + 1];
+    std::sort(entries.begin() + start, entries.begin() + end);
+    csr.rowStarts[row] = csr.values.size();
+    for (int64_t k = start; k < end; k++) {
+      if (k > start && entries[k].first == entries[k - 1].first)
+        csr.values.back() += entries[k].second;
+      else {
+        csr.columns.push_back(entries[k].first);
+        csr.values.push_back(entries[k].second);
+      }
+    }
+    start = end;
+  }
+  csr.rowStarts[nRows] = csr.values.size();
+  return csr;
+}
+}
+}
+
+#endif /* CSRMATRIX_CPP_ */
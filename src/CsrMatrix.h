@@ -0,0 +1,44 @@
+/*
+ * This file is part of GloVeHd
+ *
+ * Copyright 2023 Observational Health Data Sciences and Informatics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CSRMATRIX_H_
+#define CSRMATRIX_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace ohdsi {
+namespace glovehd {
+
+// Sparse matrix in compressed sparse row format. The entries of row r are at 
+// positions rowStarts[r] up to rowStarts[r + 1], sorted by column.
+struct CsrMatrix {
+  std::vector<int64_t> rowStarts;
+  std::vector<int> columns;
+  std::vector<double> values;
+  
+  // Builds a CSR matrix from triplets, summing duplicate entries:
+  static CsrMatrix fromTriplets(const std::vector<int>& rows, 
+                                const std::vector<int>& columns, 
+                                const std::vector<double>& values, 
+                                const int nRows);
+};
+}
+}
+
+#endif /* CSRMATRIX_H_ */
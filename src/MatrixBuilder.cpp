@@ -20,30 +20,58 @@
 #define MATRIXBUILDER_CPP_
 
 #include <ctime>
+#include <exception>
 #include <string>
+#include <thread>
 #include <Rcpp.h>
 #include "MatrixBuilder.h"
 #include "PersonDataIterator.h"
+#include "WorkStealingQueues.h"
 
 using namespace Rcpp;
 
 namespace ohdsi {
 namespace glovehd {
 
+// Persons with more pairs than this are split into several tasks:
+static const int64_t MAX_TASK_PAIRS = 1000000;
+// Number of pairs to collect before handing a batch of tasks to the workers. 
+// Batches are flushed as soon as they reach this size, also in the middle of a
+// person, so together with MAX_TASK_PAIRS this bounds the size of the triplet 
+// buffers passed between threads. (A task is never smaller than one day, so a
+// single day with more pairs than MAX_TASK_PAIRS can still exceed the bound.)
+static const int64_t BATCH_PAIRS = 10000000;
+
+// Rethrows the first exception captured by a worker thread, if any:
+static void rethrowFirst(const std::vector<std::exception_ptr>& errors) {
+  for (const std::exception_ptr& error : errors)
+    if (error)
+      std::rethrow_exception(error);
+}
+
 MatrixBuilder::MatrixBuilder(const List& _conceptData,
-                             const DataFrame& _observationPeriodReference,
                              const std::vector<double>& _weights,
                              const int _windowSize,
                              const int _context,
                              const std::vector<double>& _conceptIds,
-                             const DataFrame& _conceptAncestor) :
+                             const DataFrame& _conceptAncestor,
+                             const bool _aggregateDays,
+                             const int _maxCores) :
 matrix(_conceptIds.size(), _conceptIds.size()),
-personDataIterator(_conceptData, _observationPeriodReference, _conceptAncestor),
+personDataIterator(_conceptData, _conceptAncestor),
 weights(_weights),
 windowSize(_windowSize),
 context(_context),
 conceptIds(_conceptIds),
-conceptIdToIndex() {
+conceptIdToIndex(),
+aggregateDays(_aggregateDays),
+maxCores(_maxCores),
+shardMatrices(),
+persons(0),
+pairs(0),
+tasks(0),
+costHistogramPersons(),
+costHistogramPairs() {
   switch(context) {
   case 0:
     // Symmetrical context
@@ -58,6 +86,12 @@ conceptIdToIndex() {
   default:
     ::Rf_error("Illegal context");
   }
+  if ((int)weights.size() < priorDays + postDays + 1)
+    ::Rf_error("Need at least %d weights for this window size and context", priorDays + postDays + 1);
+  if (maxCores > 1) {
+    for (int i = 0; i < maxCores; i++)
+      shardMatrices.push_back(SparseTripletMatrix<float>(_conceptIds.size(), _conceptIds.size()));
+  }
   for (unsigned int i = 0; i < _conceptIds.size(); i++) {
     conceptIdToIndex[_conceptIds[i]] = i;
     // if (conceptIdToIndex.size() % 1000 == 0) {
@@ -68,50 +102,222 @@ conceptIdToIndex() {
   }
 }
 
-void MatrixBuilder::processPerson(PersonData& personData) {
+std::shared_ptr<PersonDays> MatrixBuilder::toPersonDays(PersonData& personData) {
+  // Map concept IDs to matrix indices once per person, dropping concepts that
+  // were pruned from the vocabulary. conceptData is sorted and unique by 
+  // startDay and conceptId (by PersonDataIterator)
+  std::shared_ptr<PersonDays> personDays(new PersonDays());
+  personDays->indices.reserve(personData.conceptDatas->size());
+  for (const ConceptData& conceptData : *personData.conceptDatas) {
+    std::unordered_map<int64_t, int>::iterator iterator = conceptIdToIndex.find(conceptData.conceptId);
+    if (iterator != conceptIdToIndex.end()) {
+      if (personDays->days.empty() || personDays->days.back() != conceptData.startDay) {
+        personDays->days.push_back(conceptData.startDay);
+        personDays->dayStarts.push_back(personDays->indices.size());
+      }
+      personDays->indices.push_back(iterator->second);
+    }
+  }
+  personDays->dayStarts.push_back(personDays->indices.size());
+  return personDays;
+}
+
+void MatrixBuilder::addTasks(std::shared_ptr<PersonDays> personDays, std::vector<PairTask>& batch, int64_t& batchPairs) {
+  // The cost of a focus day is the number of pairs it generates: the concepts on
+  // that day times the concepts in its window.
+  const std::vector<int>& days = personDays->days;
+  const std::vector<int>& dayStarts = personDays->dayStarts;
+  int nDays = days.size();
   int priorCursor = 0;
   int postCursor = 0;
-  int currentDay = -1;
-  int conceptDataSize = personData.conceptDatas->size();
-  // conceptData is sorted and unique by startDay and conceptId (by PersonDataIterator)
-  for (std::vector<ConceptData>::iterator conceptData = personData.conceptDatas->begin(); 
-       conceptData != personData.conceptDatas->end(); 
-       ++conceptData) {
-    if (conceptData->startDay > currentDay) {
-      currentDay = conceptData->startDay;
-      while (personData.conceptDatas->at(priorCursor).startDay < currentDay - priorDays && 
-             priorCursor < conceptDataSize - 1)
-        priorCursor++;
-      while (personData.conceptDatas->at(postCursor).startDay < currentDay + postDays && 
-             postCursor < conceptDataSize - 1)
-        postCursor++;
-      if (personData.conceptDatas->at(postCursor).startDay > currentDay + postDays)
-        postCursor--;
+  int64_t personPairs = 0;
+  int64_t taskPairs = 0;
+  int firstDay = 0;
+  for (int k = 0; k < nDays; k++) {
+    while (days[priorCursor] < days[k] - priorDays)
+      priorCursor++;
+    while (postCursor + 1 < nDays && days[postCursor + 1] <= days[k] + postDays)
+      postCursor++;
+    int64_t dayPairs = (int64_t)(dayStarts[k + 1] - dayStarts[k]) * (dayStarts[postCursor + 1] - dayStarts[priorCursor]);
+    personPairs += dayPairs;
+    taskPairs += dayPairs;
+    if (taskPairs >= MAX_TASK_PAIRS) {
+      batch.push_back(PairTask(personDays, firstDay, k + 1));
+      batchPairs += taskPairs;
+      firstDay = k + 1;
+      taskPairs = 0;
+      if (batchPairs >= BATCH_PAIRS) {
+        processBatch(batch);
+        batchPairs = 0;
+      }
     }
-    for (int i = priorCursor; i <= postCursor; i++) {
-      ConceptData contextConceptData = personData.conceptDatas->at(i);
-      // if (contextConceptData.startDay != currentDay && 
-      //     contextConceptData.conceptId != conceptData->conceptId) {
-      double weight = weights.at(contextConceptData.startDay - currentDay + priorDays);
-      int index = conceptIdToIndex[conceptData->conceptId];
-      int contextIndex = conceptIdToIndex[contextConceptData.conceptId];
-      matrix.add(index, contextIndex, weight);
-      // }
+  }
+  if (firstDay < nDays) {
+    batch.push_back(PairTask(personDays, firstDay, nDays));
+    batchPairs += taskPairs;
+  }
+  
+  size_t bucket = 0;
+  while (((int64_t)1 << (bucket + 1)) <= personPairs)
+    bucket++;
+  if (bucket >= costHistogramPersons.size()) {
+    costHistogramPersons.resize(bucket + 1, 0);
+    costHistogramPairs.resize(bucket + 1, 0);
+  }
+  costHistogramPersons[bucket]++;
+  costHistogramPairs[bucket] += personPairs;
+  persons++;
+  pairs += personPairs;
+}
+
+template<typename Target>
+void MatrixBuilder::processTask(const PairTask& task, Target& target, ContextBuffer& contextBuffer) {
+  const std::vector<int>& days = task.personDays->days;
+  const std::vector<int>& dayStarts = task.personDays->dayStarts;
+  const std::vector<int>& indices = task.personDays->indices;
+  int nDays = days.size();
+  int priorCursor = 0;
+  int postCursor = task.firstDay;
+  for (int k = task.firstDay; k < task.lastDay; k++) {
+    int currentDay = days[k];
+    while (days[priorCursor] < currentDay - priorDays)
+      priorCursor++;
+    while (postCursor + 1 < nDays && days[postCursor + 1] <= currentDay + postDays)
+      postCursor++;
+    if (aggregateDays) {
+      // All concepts on the same day share the same context, so sum the weights 
+      // per context concept once and add a single entry per pair of concepts:
+      for (int c = priorCursor; c <= postCursor; c++) {
+        float weight = weights[days[c] - currentDay + priorDays];
+        for (int i = dayStarts[c]; i < dayStarts[c + 1]; i++) {
+          int contextIndex = indices[i];
+          if (!contextBuffer.isTouched[contextIndex]) {
+            contextBuffer.isTouched[contextIndex] = true;
+            contextBuffer.touched.push_back(contextIndex);
+          }
+          contextBuffer.weights[contextIndex] += weight;
+        }
+      }
+      for (int j = dayStarts[k]; j < dayStarts[k + 1]; j++) {
+        for (int contextIndex : contextBuffer.touched) {
+          target.add(indices[j], contextIndex, contextBuffer.weights[contextIndex]);
+        }
+      }
+      for (int contextIndex : contextBuffer.touched) {
+        contextBuffer.weights[contextIndex] = 0;
+        contextBuffer.isTouched[contextIndex] = false;
+      }
+      contextBuffer.touched.clear();
+    } else {
+      for (int j = dayStarts[k]; j < dayStarts[k + 1]; j++) {
+        for (int c = priorCursor; c <= postCursor; c++) {
+          double weight = weights[days[c] - currentDay + priorDays];
+          for (int i = dayStarts[c]; i < dayStarts[c + 1]; i++) {
+            target.add(indices[j], indices[i], weight);
+          }
+        }
+      }
     }
   }
 }
 
+void MatrixBuilder::processBatch(std::vector<PairTask>& batch) {
+  tasks += batch.size();
+  if (maxCores == 1) {
+    ContextBuffer contextBuffer(conceptIds.size());
+    for (const PairTask& task : batch)
+      processTask(task, matrix, contextBuffer);
+  } else {
+    // First the workers compute the co-occurrences of the tasks, writing them to
+    // buffers per shard. Then each shard owner adds its buffers to its shard 
+    // matrix. No locking is needed other than for taking tasks from the queues:
+    WorkStealingQueues<PairTask> queues(maxCores);
+    for (size_t i = 0; i < batch.size(); i++)
+      queues.push(i % maxCores, batch[i]);
+    // Exceptions (e.g. std::bad_alloc) cannot leave a thread, so they are 
+    // stored and rethrown on the main thread after joining:
+    std::vector<ShardedTriplets> workerTriplets(maxCores, ShardedTriplets(maxCores));
+    std::vector<std::exception_ptr> errors(maxCores);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < maxCores; t++) {
+      threads.push_back(std::thread([this, &queues, &workerTriplets, &errors, t]() {
+        try {
+          ContextBuffer contextBuffer(conceptIds.size());
+          PairTask task;
+          while (queues.next(t, task))
+            processTask(task, workerTriplets[t], contextBuffer);
+        } catch (...) {
+          errors[t] = std::current_exception();
+        }
+      }));
+    }
+    for (std::thread& thread : threads)
+      thread.join();
+    rethrowFirst(errors);
+    threads.clear();
+    for (int s = 0; s < maxCores; s++) {
+      threads.push_back(std::thread([this, &workerTriplets, &errors, s]() {
+        try {
+          for (ShardedTriplets& triplets : workerTriplets) {
+            for (const Triplet& triplet : triplets.shards[s])
+              shardMatrices[s].add(triplet.i, triplet.j, triplet.x);
+            std::vector<Triplet>().swap(triplets.shards[s]);
+          }
+        } catch (...) {
+          errors[s] = std::current_exception();
+        }
+      }));
+    }
+    for (std::thread& thread : threads)
+      thread.join();
+    rethrowFirst(errors);
+  }
+  batch.clear();
+}
+
+List MatrixBuilder::getBuildStats() {
+  NumericVector minPairs(costHistogramPersons.size());
+  NumericVector histogramPersons(costHistogramPersons.size());
+  NumericVector histogramPairs(costHistogramPersons.size());
+  for (size_t i = 0; i < costHistogramPersons.size(); i++) {
+    minPairs[i] = (i == 0) ? 0 : (double)((int64_t)1 << i);
+    histogramPersons[i] = costHistogramPersons[i];
+    histogramPairs[i] = costHistogramPairs[i];
+  }
+  DataFrame costHistogram = DataFrame::create(_["minPairs"] = minPairs, 
+                                              _["persons"] = histogramPersons, 
+                                              _["pairs"] = histogramPairs);
+  return List::create(_["persons"] = (double)persons,
+                      _["pairs"] = (double)pairs,
+                      _["tasks"] = (double)tasks,
+                      _["costHistogram"] = costHistogram);
+}
 
 S4 MatrixBuilder::buildMatrix() {
+  std::vector<PairTask> batch;
+  int64_t batchPairs = 0;
   while (personDataIterator.hasNext()) {
     PersonData personData = personDataIterator.next();
-    processPerson(personData);
+    addTasks(toPersonDays(personData), batch, batchPairs);
+    if (batchPairs >= BATCH_PAIRS) {
+      processBatch(batch);
+      batchPairs = 0;
+    }
+  }
+  processBatch(batch);
+  // Shards are disjoint, so merging them one at a time and releasing each after
+  // merging keeps peak memory at about one matrix plus one shard:
+  for (SparseTripletMatrix<float>& shardMatrix : shardMatrices) {
+    matrix.merge(shardMatrix);
+    shardMatrix = SparseTripletMatrix<float>();
   }
   CharacterVector dimNames(conceptIds.size());
   for (unsigned int i = 0; i < conceptIds.size(); i++) {
     dimNames[i] = std::to_string((int) conceptIds[i]);
   }
-  return matrix.get_sparse_triplet_matrix(dimNames, dimNames);
+  S4 result = matrix.get_sparse_triplet_matrix(dimNames, dimNames);
+  result.attr("buildStats") = getBuildStats();
+  return result;
 }
 
 }
@@ -20,6 +20,8 @@
 #define MATRIXBUILDER_H_
 
 #include <Rcpp.h>
+#include <memory>
+#include <unordered_map>
 #include "PersonDataIterator.h"
 #include "SparseTripletMatrix.h"
 using namespace Rcpp;
@@ -27,18 +29,88 @@ using namespace Rcpp;
 namespace ohdsi {
 namespace glovehd {
 
+// The concepts of a single person mapped to matrix indices and grouped by day.
+// The indices of the concepts on days[i] are indices[dayStarts[i]] up to
+// indices[dayStarts[i + 1]].
+struct PersonDays {
+  std::vector<int> days;
+  std::vector<int> dayStarts;
+  std::vector<int> indices;
+};
+
+// A range of focus days [firstDay, lastDay) of a person. Heavy persons are 
+// split into several tasks.
+struct PairTask {
+  PairTask() :
+  personDays(),
+  firstDay(0),
+  lastDay(0) {}
+  
+  PairTask(std::shared_ptr<PersonDays> _personDays, int _firstDay, int _lastDay) :
+  personDays(_personDays),
+  firstDay(_firstDay),
+  lastDay(_lastDay) {}
+  
+  std::shared_ptr<PersonDays> personDays;
+  int firstDay;
+  int lastDay;
+};
+
+// Scratch space of a worker for accumulating the context weights of a day.
+struct ContextBuffer {
+  ContextBuffer(int _nConcepts) :
+  weights(_nConcepts, 0),
+  isTouched(_nConcepts, false),
+  touched() {}
+  
+  std::vector<float> weights;
+  std::vector<bool> isTouched;
+  std::vector<int> touched;
+};
+
+// A co-occurrence weight to be added to the matrix.
+struct Triplet {
+  Triplet(uint32_t _i, uint32_t _j, float _x) :
+  i(_i),
+  j(_j),
+  x(_x) {}
+  
+  uint32_t i;
+  uint32_t j;
+  float x;
+};
+
+// Co-occurrences produced by a worker, split by the shard owning the focus row
+// (row % number of shards).
+struct ShardedTriplets {
+  ShardedTriplets(int _nShards) :
+  shards(_nShards) {}
+  
+  void add(uint32_t i, uint32_t j, float x) {
+    shards[i % shards.size()].push_back(Triplet(i, j, x));
+  }
+  
+  std::vector<std::vector<Triplet>> shards;
+};
+
 class MatrixBuilder {
 public:
   MatrixBuilder(const List& _conceptData,
-                const DataFrame& _observationPeriodReference,
                 const std::vector<double>& _weights,
                 const int _windowSize,
                 const int _context,
                 const std::vector<double>& _conceptIds,
-                const DataFrame& _conceptAncestor);
+                const DataFrame& _conceptAncestor,
+                const bool _aggregateDays,
+                const int _maxCores);
   S4 buildMatrix();
 private:
-  void processPerson(PersonData& personData);
+  std::shared_ptr<PersonDays> toPersonDays(PersonData& personData);
+  void addTasks(std::shared_ptr<PersonDays> personDays, std::vector<PairTask>& batch, int64_t& batchPairs);
+  void processBatch(std::vector<PairTask>& batch);
+  template<typename Target>
+  void processTask(const PairTask& task, Target& target, ContextBuffer& contextBuffer);
+  List getBuildStats();
   
   SparseTripletMatrix<float> matrix;
   PersonDataIterator personDataIterator;
@@ -46,9 +118,20 @@ private:
   int windowSize;
   int context;
   std::vector<double> conceptIds;
-  std::map<int64_t, int> conceptIdToIndex;
+  std::unordered_map<int64_t, int> conceptIdToIndex;
   int priorDays;
   int postDays;
+  bool aggregateDays;
+  int maxCores;
+  // When using multiple threads, shard s holds the matrix rows where 
+  // row % maxCores == s, so shards never overlap:
+  std::vector<SparseTripletMatrix<float>> shardMatrices;
+  int64_t persons;
+  int64_t pairs;
+  int64_t tasks;
+  // Number of persons and pairs per power-of-2 bucket of pairs per person:
+  std::vector<int64_t> costHistogramPersons;
+  std::vector<int64_t> costHistogramPairs;
 };
 }
 }
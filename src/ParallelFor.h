@@ -0,0 +1,64 @@
+/*
+ * This file is part of GloVeHd
+ *
+ * Copyright 2023 Observational Health Data Sciences and Informatics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PARALLELFOR_H_
+#define PARALLELFOR_H_
+
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace ohdsi {
+namespace glovehd {
+
+// Runs function(thread, start, end) on nThreads threads, splitting [0, n) in 
+// contiguous ranges. Thread t gets [n * t / nThreads, n * (t + 1) / nThreads),
+// so results written per thread can be concatenated in thread order. The 
+// function must not call the R API. An exception thrown by the function (e.g.
+// std::bad_alloc) is rethrown on the calling thread after all threads are 
+// joined, so it can be forwarded to R.
+template<typename F>
+void parallelFor(const int nThreads, const int64_t n, F function) {
+  if (nThreads == 1) {
+    function(0, 0, n);
+    return;
+  }
+  std::vector<std::exception_ptr> errors(nThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < nThreads; t++) {
+    int64_t start = n * t / nThreads;
+    int64_t end = n * (t + 1) / nThreads;
+    threads.push_back(std::thread([&function, &errors, t, start, end]() {
+      try {
+        function(t, start, end);
+      } catch (...) {
+        errors[t] = std::current_exception();
+      }
+    }));
+  }
+  for (std::thread& thread : threads)
+    thread.join();
+  for (const std::exception_ptr& error : errors)
+    if (error)
+      std::rethrow_exception(error);
+}
+}
+}
+
+#endif /* PARALLELFOR_H_ */
@@ -30,40 +30,15 @@ using namespace Rcpp;
 namespace ohdsi {
 namespace glovehd {
 
-PersonDataIterator::PersonDataIterator(const List& _conceptData, const DataFrame& _observationPeriodReference,
-                                       const DataFrame& _conceptAncestor) :
+// The concept data is sorted by observation period, and already holds the day
+// offsets relative to the observation period start, so observation periods are
+// streamed from the concept data alone. Observation periods without concept data
+// are skipped, as they do not contribute to the matrix.
+PersonDataIterator::PersonDataIterator(const List& _conceptData, const DataFrame& _conceptAncestor) :
 conceptDataIterator(_conceptData, true), 
-observationPeriodStartDates(0), 
-observationPeriodEndDates(0), 
-observationPeriodCursor(0), 
 conceptDataCursor(0),
-conceptToAncestors(0) {
-  
-  personIds = _observationPeriodReference["personId"];
-  observationPeriodIds = _observationPeriodReference["observationPeriodId"];
-  observationPeriodSeqIds = _observationPeriodReference["observationPeriodSeqId"];
-  observationPeriodStartDates = _observationPeriodReference["observationPeriodStartDate"];
-  observationPeriodEndDates = _observationPeriodReference["observationPeriodEndDate"];
-  
-  if (_conceptAncestor.size() == 0) {
-    rollUpConcepts = false;
-  } else {
-    rollUpConcepts = true;
-    NumericVector ancestorConceptId = _conceptAncestor["ancestorConceptId"];
-    NumericVector descendantConceptId = _conceptAncestor["descendantConceptId"];
-    for (int i = 0; i < ancestorConceptId.size(); i++) {
-      int id1 = (int)descendantConceptId[i];
-      int id2 = (int)ancestorConceptId[i];
-      if (conceptToAncestors.find(id1) == conceptToAncestors.end()) {
-        std::vector<int> ancestors(1);
-        ancestors.push_back(id2);
-        conceptToAncestors[id2] = ancestors;
-      } else {
-        conceptToAncestors[id1].push_back(id2);
-      }
-    }
-  }
-  // Rcpp::Rcout << observationPeriodIds.length() << " length\n";
+conceptAncestorMap(_conceptAncestor) {
+  rollUpConcepts = !conceptAncestorMap.isEmpty();
   loadNextConceptDatas();
 }
 
@@ -78,30 +53,12 @@ void PersonDataIterator::loadNextConceptDatas() {
 }
 
 bool PersonDataIterator::hasNext() {
-  return (observationPeriodCursor < observationPeriodIds.length());
-  // return (observationPeriodCursor < 100);
+  return (conceptDataCursor < conceptDataObservationPeriodSeqIds.length());
 }
 
 PersonData PersonDataIterator::next() {
-  int observationPeriodSeqId = observationPeriodSeqIds.at(observationPeriodCursor);
-  PersonData nextPerson(personIds.at(observationPeriodCursor),
-                        observationPeriodIds.at(observationPeriodCursor),
-                        observationPeriodSeqId,
-                        observationPeriodStartDates.at(observationPeriodCursor),
-                        observationPeriodEndDates.at(observationPeriodCursor));
-  observationPeriodCursor++;
-  while (conceptDataCursor < conceptDataObservationPeriodSeqIds.length() && 
-         conceptDataObservationPeriodSeqIds.at(conceptDataCursor) < observationPeriodSeqId) {
-    conceptDataCursor++;
-    if (conceptDataCursor == conceptDataObservationPeriodSeqIds.length()){
-      if (conceptDataIterator.hasNext()){
-        loadNextConceptDatas();
-        conceptDataCursor = 0;
-      } else {
-        break;
-      }
-    }
-  }
+  int64_t observationPeriodSeqId = conceptDataObservationPeriodSeqIds.at(conceptDataCursor);
+  PersonData nextPerson(observationPeriodSeqId);
   // Environment base = Environment::namespace_env("base");
   // Function message = base["message"];
   while (conceptDataCursor < conceptDataObservationPeriodSeqIds.length() && 
@@ -110,13 +67,13 @@ PersonData PersonDataIterator::next() {
     double startDay = conceptDataStartDays.at(conceptDataCursor);
     double endDay = conceptDataEndDays.at(conceptDataCursor);
     if (rollUpConcepts) {
-      std::unordered_map<int, std::vector<int>>::iterator iterator = conceptToAncestors.find((int)conceptId);
-      if (iterator != conceptToAncestors.end()) {
-        for (int ancestorConceptId: iterator->second) {
-          ConceptData conceptData(startDay, endDay, (double)ancestorConceptId);
+      const std::vector<int64_t>* ancestors = conceptAncestorMap.getAncestors((int64_t)conceptId);
+      if (ancestors != NULL) {
+        for (int64_t ancestorConceptId: *ancestors) {
+          ConceptData conceptData(startDay, endDay, ancestorConceptId);
           nextPerson.conceptDatas->push_back(conceptData);
         }
-        // message("- concept " + std::to_string(conceptId) + " ancestors: " + std::to_string(iterator->second.size()));
+        // message("- concept " + std::to_string(conceptId) + " ancestors: " + std::to_string(ancestors->size()));
       }
     } else {
       ConceptData conceptData(startDay, endDay, conceptId);
@@ -23,6 +23,7 @@
 
 #include <Rcpp.h>
 #include "AndromedaTableIterator.h"
+#include "ConceptAncestorMap.h"
 
 using namespace Rcpp;
 
@@ -54,16 +55,8 @@ struct ConceptData {
 };
 
 struct PersonData {
-  PersonData(String _personId,
-             String _observationPeriodId,
-             int _observationPeriodSeqId,
-             Date _observationPeriodStartDate,
-             Date _observationPeriodEndDate) :
-  personId(_personId),
-  observationPeriodId(_observationPeriodId),
+  PersonData(int64_t _observationPeriodSeqId) :
   observationPeriodSeqId(_observationPeriodSeqId),
-  observationPeriodStartDate(_observationPeriodStartDate),
-  observationPeriodEndDate(_observationPeriodEndDate),
   conceptDatas(0) {
     conceptDatas = new std::vector<ConceptData>;
   }
@@ -72,38 +65,26 @@ struct PersonData {
     delete conceptDatas;
   }
 
-  std::string personId;
-  std::string observationPeriodId;
-  int observationPeriodSeqId;
-  Date observationPeriodStartDate;
-  Date observationPeriodEndDate;
+  int64_t observationPeriodSeqId;
   std::vector<ConceptData>* conceptDatas;
 };
 
 class PersonDataIterator {
 public:
-  PersonDataIterator(const List& _conceptData, const DataFrame& _observationPeriodReference,
-                     const DataFrame& _conceptAncestor);
+  PersonDataIterator(const List& _conceptData, const DataFrame& _conceptAncestor);
   bool hasNext();
   PersonData next();
 private:
   AndromedaTableIterator conceptDataIterator;
-  
-  CharacterVector personIds;
-  CharacterVector observationPeriodIds;
-  NumericVector observationPeriodSeqIds;
-  DateVector observationPeriodStartDates;
-  DateVector observationPeriodEndDates;
 
   NumericVector conceptDataStartDays;
   NumericVector conceptDataEndDays;
   NumericVector conceptDataConceptIds;
   NumericVector conceptDataObservationPeriodSeqIds;
 
-  int observationPeriodCursor;
   int conceptDataCursor;
   bool rollUpConcepts;
-  std::unordered_map<int, std::vector<int>> conceptToAncestors;
+  ConceptAncestorMap conceptAncestorMap;
   void loadNextConceptDatas();
 };
 }
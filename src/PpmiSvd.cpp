@@ -0,0 +1,343 @@
+/*
+ * This file is part of GloVeHd
+ *
+ * Copyright 2023 Observational Health Data Sciences and Informatics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PPMISVD_CPP_
+#define PPMISVD_CPP_
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <Rcpp.h>
+#include "PpmiSvd.h"
+#include "ParallelFor.h"
+
+using namespace Rcpp;
+
+namespace ohdsi {
+namespace glovehd {
+
+// Number of extra columns used for the random projection, improving the 
+// accuracy of the smallest requested singular vectors:
+static const int OVERSAMPLING = 10;
+// Number of columns orthonormalized together, see PpmiSvd::orthonormalize:
+static const int ORTHONORMALIZE_BLOCK = 16;
+
+// Eigen decomposition of a small symmetric matrix (row-major, n x n) using the
+// cyclic Jacobi method. Eigenvectors are returned as the columns of 
+// eigenvectors, sorted by descending eigenvalue.
+static void symmetricEigen(std::vector<double> a, 
+                           const int n, 
+                           std::vector<double>& eigenvalues, 
+                           std::vector<double>& eigenvectors) {
+  std::vector<double> v(n * n, 0);
+  for (int k = 0; k < n; k++)
+    v[k * n + k] = 1;
+  double total = 0;
+  for (double value : a)
+    total += value * value;
+  for (int sweep = 0; sweep < 100; sweep++) {
+    double offDiagonal = 0;
+    for (int p = 0; p < n; p++)
+      for (int q = p + 1; q < n; q++)
+        offDiagonal += a[p * n + q] * a[p * n + q];
+    if (offDiagonal <= 1e-24 * total)
+      break;
+    for (int p = 0; p < n; p++) {
+      for (int q = p + 1; q < n; q++) {
+        double apq = a[p * n + q];
+        if (apq == 0)
+          continue;
+        double theta = (a[q * n + q] - a[p * n + p]) / (2 * apq);
+        double t = (theta >= 0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1));
+        double c = 1 / std::sqrt(t * t + 1);
+        double s = t * c;
+        for (int k = 0; k < n; k++) {
+          double akp = a[k * n + p];
+          double akq = a[k * n + q];
+          a[k * n + p] = c * akp - s * akq;
+          a[k * n + q] = s * akp + c * akq;
+        }
+        for (int k = 0; k < n; k++) {
+          double apk = a[p * n + k];
+          double aqk = a[q * n + k];
+          a[p * n + k] = c * apk - s * aqk;
+          a[q * n + k] = s * apk + c * aqk;
+        }
+        for (int k = 0; k < n; k++) {
+          double vkp = v[k * n + p];
+          double vkq = v[k * n + q];
+          v[k * n + p] = c * vkp - s * vkq;
+          v[k * n + q] = s * vkp + c * vkq;
+        }
+      }
+    }
+  }
+  std::vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&a, n](int x, int y) {
+    return a[x * n + x] > a[y * n + y];
+  });
+  eigenvalues.resize(n);
+  eigenvectors.resize(n * n);
+  for (int k = 0; k < n; k++) {
+    eigenvalues[k] = a[order[k] * n + order[k]];
+    for (int r = 0; r < n; r++)
+      eigenvectors[r * n + k] = v[r * n + order[k]];
+  }
+}
+
+PpmiSvd::PpmiSvd(const std::vector<int>& _i,
+                 const std::vector<int>& _j,
+                 const std::vector<double>& _x,
+                 const int _nConcepts,
+                 const int _vectorSize,
+                 const double _shift,
+                 const double _contextSmoothing,
+                 const int _powerIterations,
+                 const int _maxCores,
+                 const int _seed) :
+ppmi(),
+ppmiTransposed(),
+nConcepts(_nConcepts),
+vectorSize(_vectorSize),
+nColumns(std::min(_vectorSize + OVERSAMPLING, _nConcepts)),
+shift(_shift),
+contextSmoothing(_contextSmoothing),
+powerIterations(_powerIterations),
+maxCores(_maxCores),
+seed(_seed) {
+  if (shift <= 0)
+    ::Rf_error("Shift (%f) must be larger than 0", shift);
+  if (vectorSize > nConcepts)
+    ::Rf_error("Vector size (%d) cannot be larger than the number of concepts (%d)", vectorSize, nConcepts);
+  computePpmi(_i, _j, _x);
+}
+
+void PpmiSvd::computePpmi(const std::vector<int>& i, const std::vector<int>& j, const std::vector<double>& x) {
+  // PMI(i, j) = log(x_ij * Z / (rowSum_i * colSum_j ^ alpha)), with Z the sum 
+  // of the smoothed column sums, which is equal to the total when alpha = 1:
+  std::vector<double> rowSums(nConcepts, 0);
+  std::vector<double> colSums(nConcepts, 0);
+  for (size_t k = 0; k < x.size(); k++) {
+    rowSums[i[k]] += x[k];
+    colSums[j[k]] += x[k];
+  }
+  std::vector<double> logColWeights(nConcepts, 0);
+  double z = 0;
+  for (int k = 0; k < nConcepts; k++) {
+    if (colSums[k] > 0) {
+      logColWeights[k] = contextSmoothing * std::log(colSums[k]);
+      z += std::exp(logColWeights[k]);
+    }
+  }
+  double logOffset = std::log(z) - std::log(shift);
+  CsrMatrix counts = CsrMatrix::fromTriplets(i, j, x, nConcepts);
+  
+  std::vector<int> rows;
+  std::vector<int> columns;
+  std::vector<double> values;
+  for (int row = 0; row < nConcepts; row++) {
+    for (int64_t k = counts.rowStarts[row]; k < counts.rowStarts[row + 1]; k++) {
+      if (counts.values[k] <= 0)
+        continue;
+      int column = counts.columns[k];
+      double pmi = std::log(counts.values[k]) - std::log(rowSums[row]) - logColWeights[column] + logOffset;
+      if (pmi > 0) {
+        rows.push_back(row);
+        columns.push_back(column);
+        values.push_back(pmi);
+      }
+    }
+  }
+  ppmi = CsrMatrix::fromTriplets(rows, columns, values, nConcepts);
+  ppmiTransposed = CsrMatrix::fromTriplets(columns, rows, values, nConcepts);
+}
+
+void PpmiSvd::multiply(const CsrMatrix& sparse, const std::vector<double>& dense, std::vector<double>& result) {
+  // Dense matrices are row-major with nColumns columns, so each thread writes
+  // its own range of result rows:
+  result.assign((size_t)nConcepts * nColumns, 0);
+  int n = nColumns;
+  parallelFor(maxCores, nConcepts, [&sparse, &dense, &result, n](int /*thread*/, int64_t start, int64_t end) {
+    for (int64_t row = start; row < end; row++) {
+      double* resultRow = &result[row * n];
+      for (int64_t k = sparse.rowStarts[row]; k < sparse.rowStarts[row + 1]; k++) {
+        const double value = sparse.values[k];
+        const double* denseRow = &dense[(size_t)sparse.columns[k] * n];
+        for (int c = 0; c < n; c++)
+          resultRow[c] += value * denseRow[c];
+      }
+    }
+  });
+}
+
+void PpmiSvd::orthonormalize(std::vector<double>& dense) {
+  // Block Gram-Schmidt on a column-major copy. Each block of columns is first 
+  // projected out of all earlier (already orthonormal) columns, a second time
+  // when needed for numerical stability. These projections are 
+  // O(nConcepts * nColumns ^ 2) and are split over threads by rows. The columns within a block are then 
+  // orthonormalized with modified Gram-Schmidt, which is only
+  // O(nConcepts * nColumns * ORTHONORMALIZE_BLOCK). Columns that are (nearly) 
+  // linearly dependent on earlier columns are set to zero.
+  int64_t m = nConcepts;
+  int n = nColumns;
+  std::vector<double> columnMajor((size_t)m * n);
+  parallelFor(maxCores, m, [&dense, &columnMajor, m, n](int /*thread*/, int64_t start, int64_t end) {
+    for (int64_t row = start; row < end; row++)
+      for (int c = 0; c < n; c++)
+        columnMajor[c * m + row] = dense[row * n + c];
+  });
+  std::vector<double> originalNorms(n);
+  for (int c = 0; c < n; c++) {
+    const double* column = &columnMajor[c * m];
+    originalNorms[c] = std::sqrt(std::inner_product(column, column + m, column, 0.0));
+  }
+  for (int blockStart = 0; blockStart < n; blockStart += ORTHONORMALIZE_BLOCK) {
+    int blockEnd = std::min(blockStart + ORTHONORMALIZE_BLOCK, n);
+    int b = blockEnd - blockStart;
+    bool project = blockStart > 0;
+    for (int pass = 0; pass < 2 && project; pass++) {
+      // dots[p * b + j] is the inner product of earlier column p and block column j:
+      std::vector<std::vector<double>> partialDots(maxCores, std::vector<double>((size_t)blockStart * b, 0));
+      parallelFor(maxCores, m, [&columnMajor, &partialDots, m, blockStart, b](int thread, int64_t start, int64_t end) {
+        std::vector<double>& dots = partialDots[thread];
+        for (int p = 0; p < blockStart; p++) {
+          const double* previousColumn = &columnMajor[p * m];
+          for (int j = 0; j < b; j++) {
+            const double* column = &columnMajor[(blockStart + j) * m];
+            dots[p * b + j] += std::inner_product(column + start, column + end, previousColumn + start, 0.0);
+          }
+        }
+      });
+      std::vector<double> dots((size_t)blockStart * b, 0);
+      for (const std::vector<double>& partialDot : partialDots)
+        for (size_t k = 0; k < dots.size(); k++)
+          dots[k] += partialDot[k];
+      parallelFor(maxCores, m, [&columnMajor, &dots, m, blockStart, b](int /*thread*/, int64_t start, int64_t end) {
+        for (int j = 0; j < b; j++) {
+          double* column = &columnMajor[(blockStart + j) * m];
+          for (int p = 0; p < blockStart; p++) {
+            const double dot = dots[p * b + j];
+            if (dot == 0)
+              continue;
+            const double* previousColumn = &columnMajor[p * m];
+            for (int64_t row = start; row < end; row++)
+              column[row] -= dot * previousColumn[row];
+          }
+        }
+      });
+      // Only project a second time if a column lost most of its norm, as 
+      // rounding errors are then large relative to what is left ("twice is 
+      // enough"):
+      project = false;
+      for (int c = blockStart; c < blockEnd; c++) {
+        const double* column = &columnMajor[c * m];
+        if (std::sqrt(std::inner_product(column, column + m, column, 0.0)) < 0.5 * originalNorms[c])
+          project = true;
+      }
+    }
+    for (int c = blockStart; c < blockEnd; c++) {
+      double* column = &columnMajor[c * m];
+      for (int previous = blockStart; previous < c; previous++) {
+        const double* previousColumn = &columnMajor[previous * m];
+        double dot = std::inner_product(column, column + m, previousColumn, 0.0);
+        for (int64_t row = 0; row < m; row++)
+          column[row] -= dot * previousColumn[row];
+      }
+      double norm = std::sqrt(std::inner_product(column, column + m, column, 0.0));
+      if (norm <= 1e-10 * originalNorms[c] || norm == 0)
+        std::fill(column, column + m, 0.0);
+      else
+        for (int64_t row = 0; row < m; row++)
+          column[row] /= norm;
+    }
+  }
+  parallelFor(maxCores, m, [&dense, &columnMajor, m, n](int /*thread*/, int64_t start, int64_t end) {
+    for (int64_t row = start; row < end; row++)
+      for (int c = 0; c < n; c++)
+        dense[row * n + c] = columnMajor[c * m + row];
+  });
+}
+
+NumericMatrix PpmiSvd::computeVectors() {
+  // Random range finder with power iterations (Halko, Martinsson & Tropp 2011):
+  std::mt19937_64 generator(seed);
+  std::normal_distribution<double> normal(0.0, 1.0);
+  std::vector<double> omega((size_t)nConcepts * nColumns);
+  for (double& value : omega)
+    value = normal(generator);
+  std::vector<double> y;
+  multiply(ppmi, omega, y);
+  orthonormalize(y);
+  std::vector<double> z;
+  for (int iteration = 0; iteration < powerIterations; iteration++) {
+    multiply(ppmiTransposed, y, z);
+    orthonormalize(z);
+    multiply(ppmi, z, y);
+    orthonormalize(y);
+  }
+  
+  // B = Q' * PPMI is small (nColumns x nConcepts). Its left singular vectors 
+  // are the eigenvectors of B * B' = Bt' * Bt:
+  std::vector<double> bt;
+  multiply(ppmiTransposed, y, bt);
+  int n = nColumns;
+  std::vector<std::vector<double>> partialGrams(maxCores, std::vector<double>(n * n, 0));
+  parallelFor(maxCores, nConcepts, [&bt, &partialGrams, n](int thread, int64_t start, int64_t end) {
+    std::vector<double>& gram = partialGrams[thread];
+    for (int64_t row = start; row < end; row++) {
+      const double* btRow = &bt[row * n];
+      for (int p = 0; p < n; p++)
+        for (int q = p; q < n; q++)
+          gram[p * n + q] += btRow[p] * btRow[q];
+    }
+  });
+  std::vector<double> gram(n * n, 0);
+  for (const std::vector<double>& partialGram : partialGrams)
+    for (int p = 0; p < n; p++)
+      for (int q = p; q < n; q++)
+        gram[p * n + q] += partialGram[p * n + q];
+  for (int p = 0; p < n; p++)
+    for (int q = 0; q < p; q++)
+      gram[p * n + q] = gram[q * n + p];
+  std::vector<double> eigenvalues;
+  std::vector<double> eigenvectors;
+  symmetricEigen(gram, n, eigenvalues, eigenvectors);
+  
+  // Vectors are U * sqrt(S), with U = Q * eigenvectors and S the singular 
+  // values (the square roots of the eigenvalues):
+  std::vector<double> scales(vectorSize);
+  for (int k = 0; k < vectorSize; k++)
+    scales[k] = std::pow(std::max(eigenvalues[k], 0.0), 0.25);
+  NumericMatrix vectors(nConcepts, vectorSize);
+  for (int64_t row = 0; row < nConcepts; row++) {
+    const double* qRow = &y[row * n];
+    for (int k = 0; k < vectorSize; k++) {
+      double value = 0;
+      for (int c = 0; c < n; c++)
+        value += qRow[c] * eigenvectors[c * n + k];
+      vectors(row, k) = value * scales[k];
+    }
+  }
+  return vectors;
+}
+}
+}
+
+#endif /* PPMISVD_CPP_ */
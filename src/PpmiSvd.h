@@ -0,0 +1,68 @@
+/*
+ * This file is part of GloVeHd
+ *
+ * Copyright 2023 Observational Health Data Sciences and Informatics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PPMISVD_H_
+#define PPMISVD_H_
+
+#include <Rcpp.h>
+#include <vector>
+#include "CsrMatrix.h"
+
+using namespace Rcpp;
+
+namespace ohdsi {
+namespace glovehd {
+
+// Computes concept vectors from a co-occurrence matrix by taking the truncated
+// SVD of its shifted positive pointwise mutual information (PPMI) matrix. The 
+// SVD is approximated using randomized subspace iteration, so only products of
+// the sparse PPMI matrix with thin dense matrices are needed.
+class PpmiSvd {
+public:
+  PpmiSvd(const std::vector<int>& _i,
+          const std::vector<int>& _j,
+          const std::vector<double>& _x,
+          const int _nConcepts,
+          const int _vectorSize,
+          const double _shift,
+          const double _contextSmoothing,
+          const int _powerIterations,
+          const int _maxCores,
+          const int _seed);
+  NumericMatrix computeVectors();
+private:
+  void computePpmi(const std::vector<int>& i, const std::vector<int>& j, const std::vector<double>& x);
+  void multiply(const CsrMatrix& sparse, const std::vector<double>& dense, std::vector<double>& result);
+  void orthonormalize(std::vector<double>& dense);
+  
+  CsrMatrix ppmi;
+  CsrMatrix ppmiTransposed;
+  int nConcepts;
+  int vectorSize;
+  // Number of columns of the dense matrices (vectorSize plus oversampling):
+  int nColumns;
+  double shift;
+  double contextSmoothing;
+  int powerIterations;
+  int maxCores;
+  int seed;
+};
+}
+}
+
+#endif /* PPMISVD_H_ */
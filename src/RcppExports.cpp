@@ -11,25 +11,84 @@ Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 #endif
 
 // buildMatrix
-S4 buildMatrix(const List& conceptData, const DataFrame& observationPeriodReference, const std::vector<double>& weights, const int windowSize, const int context, const std::vector<double>& conceptIds, const DataFrame& conceptAncestor);
-RcppExport SEXP _GloVeHd_buildMatrix(SEXP conceptDataSEXP, SEXP observationPeriodReferenceSEXP, SEXP weightsSEXP, SEXP windowSizeSEXP, SEXP contextSEXP, SEXP conceptIdsSEXP, SEXP conceptAncestorSEXP) {
+S4 buildMatrix(const List& conceptData, const std::vector<double>& weights, const int windowSize, const int context, const std::vector<double>& conceptIds, const DataFrame& conceptAncestor, const bool aggregateDays, const int maxCores);
+RcppExport SEXP _GloVeHd_buildMatrix(SEXP conceptDataSEXP, SEXP weightsSEXP, SEXP windowSizeSEXP, SEXP contextSEXP, SEXP conceptIdsSEXP, SEXP conceptAncestorSEXP, SEXP aggregateDaysSEXP, SEXP maxCoresSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< const List& >::type conceptData(conceptDataSEXP);
-    Rcpp::traits::input_parameter< const DataFrame& >::type observationPeriodReference(observationPeriodReferenceSEXP);
     Rcpp::traits::input_parameter< const std::vector<double>& >::type weights(weightsSEXP);
     Rcpp::traits::input_parameter< const int >::type windowSize(windowSizeSEXP);
     Rcpp::traits::input_parameter< const int >::type context(contextSEXP);
     Rcpp::traits::input_parameter< const std::vector<double>& >::type conceptIds(conceptIdsSEXP);
     Rcpp::traits::input_parameter< const DataFrame& >::type conceptAncestor(conceptAncestorSEXP);
-    rcpp_result_gen = Rcpp::wrap(buildMatrix(conceptData, observationPeriodReference, weights, windowSize, context, conceptIds, conceptAncestor));
+    Rcpp::traits::input_parameter< const bool >::type aggregateDays(aggregateDaysSEXP);
+    Rcpp::traits::input_parameter< const int >::type maxCores(maxCoresSEXP);
+    rcpp_result_gen = Rcpp::wrap(buildMatrix(conceptData, weights, windowSize, context, conceptIds, conceptAncestor, aggregateDays, maxCores));
+    return rcpp_result_gen;
+END_RCPP
+}
+
+// countConcepts
+DataFrame countConcepts(const List& conceptData, const DataFrame& conceptAncestor, const std::vector<double>& conceptIds, const double minCount, const int maxVocabularySize);
+RcppExport SEXP _GloVeHd_countConcepts(SEXP conceptDataSEXP, SEXP conceptAncestorSEXP, SEXP conceptIdsSEXP, SEXP minCountSEXP, SEXP maxVocabularySizeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type conceptData(conceptDataSEXP);
+    Rcpp::traits::input_parameter< const DataFrame& >::type conceptAncestor(conceptAncestorSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double>& >::type conceptIds(conceptIdsSEXP);
+    Rcpp::traits::input_parameter< const double >::type minCount(minCountSEXP);
+    Rcpp::traits::input_parameter< const int >::type maxVocabularySize(maxVocabularySizeSEXP);
+    rcpp_result_gen = Rcpp::wrap(countConcepts(conceptData, conceptAncestor, conceptIds, minCount, maxVocabularySize));
+    return rcpp_result_gen;
+END_RCPP
+}
+
+// ppmiSvd
+NumericMatrix ppmiSvd(const std::vector<int>& i, const std::vector<int>& j, const std::vector<double>& x, const int nConcepts, const int vectorSize, const double shift, const double contextSmoothing, const int powerIterations, const int maxCores, const int seed);
+RcppExport SEXP _GloVeHd_ppmiSvd(SEXP iSEXP, SEXP jSEXP, SEXP xSEXP, SEXP nConceptsSEXP, SEXP vectorSizeSEXP, SEXP shiftSEXP, SEXP contextSmoothingSEXP, SEXP powerIterationsSEXP, SEXP maxCoresSEXP, SEXP seedSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::vector<int>& >::type i(iSEXP);
+    Rcpp::traits::input_parameter< const std::vector<int>& >::type j(jSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double>& >::type x(xSEXP);
+    Rcpp::traits::input_parameter< const int >::type nConcepts(nConceptsSEXP);
+    Rcpp::traits::input_parameter< const int >::type vectorSize(vectorSizeSEXP);
+    Rcpp::traits::input_parameter< const double >::type shift(shiftSEXP);
+    Rcpp::traits::input_parameter< const double >::type contextSmoothing(contextSmoothingSEXP);
+    Rcpp::traits::input_parameter< const int >::type powerIterations(powerIterationsSEXP);
+    Rcpp::traits::input_parameter< const int >::type maxCores(maxCoresSEXP);
+    Rcpp::traits::input_parameter< const int >::type seed(seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(ppmiSvd(i, j, x, nConcepts, vectorSize, shift, contextSmoothing, powerIterations, maxCores, seed));
+    return rcpp_result_gen;
+END_RCPP
+}
+
+// projectMatrix
+S4 projectMatrix(const std::vector<int>& i, const std::vector<int>& j, const std::vector<double>& x, const std::vector<double>& baseConceptIds, const std::vector<double>& conceptIds, const DataFrame& conceptAncestor, const int maxCores);
+RcppExport SEXP _GloVeHd_projectMatrix(SEXP iSEXP, SEXP jSEXP, SEXP xSEXP, SEXP baseConceptIdsSEXP, SEXP conceptIdsSEXP, SEXP conceptAncestorSEXP, SEXP maxCoresSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::vector<int>& >::type i(iSEXP);
+    Rcpp::traits::input_parameter< const std::vector<int>& >::type j(jSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double>& >::type x(xSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double>& >::type baseConceptIds(baseConceptIdsSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double>& >::type conceptIds(conceptIdsSEXP);
+    Rcpp::traits::input_parameter< const DataFrame& >::type conceptAncestor(conceptAncestorSEXP);
+    Rcpp::traits::input_parameter< const int >::type maxCores(maxCoresSEXP);
+    rcpp_result_gen = Rcpp::wrap(projectMatrix(i, j, x, baseConceptIds, conceptIds, conceptAncestor, maxCores));
     return rcpp_result_gen;
 END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_GloVeHd_buildMatrix", (DL_FUNC) &_GloVeHd_buildMatrix, 7},
+    {"_GloVeHd_buildMatrix", (DL_FUNC) &_GloVeHd_buildMatrix, 8},
+    {"_GloVeHd_countConcepts", (DL_FUNC) &_GloVeHd_countConcepts, 5},
+    {"_GloVeHd_ppmiSvd", (DL_FUNC) &_GloVeHd_ppmiSvd, 10},
+    {"_GloVeHd_projectMatrix", (DL_FUNC) &_GloVeHd_projectMatrix, 7},
     {NULL, NULL, 0}
 };
 
@@ -21,22 +21,26 @@
 
 #include <Rcpp.h>
 #include "MatrixBuilder.h"
+#include "ConceptCounter.h"
+#include "PpmiSvd.h"
+#include "AncestorProjector.h"
 
 using namespace Rcpp;
 
 // [[Rcpp::export]]
 S4 buildMatrix(const List& conceptData,
-               const DataFrame& observationPeriodReference,
                const std::vector<double>& weights,
                const int windowSize,
                const int context,
                const std::vector<double>& conceptIds,
-               const DataFrame& conceptAncestor) {
+               const DataFrame& conceptAncestor,
+               const bool aggregateDays,
+               const int maxCores) {
 
   using namespace ohdsi::glovehd;
 
   try {
-    MatrixBuilder matrixBuilder(conceptData, observationPeriodReference, weights, windowSize, context, conceptIds, conceptAncestor);
+    MatrixBuilder matrixBuilder(conceptData, weights, windowSize, context, conceptIds, conceptAncestor, aggregateDays, maxCores);
     S4 matrix = matrixBuilder.buildMatrix();
     return matrix;
   } catch (std::exception &e) {
@@ -47,4 +51,74 @@ S4 buildMatrix(const List& conceptData,
   return R_NilValue;
 }
 
+// [[Rcpp::export]]
+DataFrame countConcepts(const List& conceptData,
+                        const DataFrame& conceptAncestor,
+                        const std::vector<double>& conceptIds,
+                        const double minCount,
+                        const int maxVocabularySize) {
+  
+  using namespace ohdsi::glovehd;
+  
+  try {
+    ConceptCounter conceptCounter(conceptData, conceptAncestor, conceptIds, minCount, maxVocabularySize);
+    DataFrame conceptCounts = conceptCounter.countConcepts();
+    return conceptCounts;
+  } catch (std::exception &e) {
+    forward_exception_to_r(e);
+  } catch (...) {
+    ::Rf_error("c++ exception (unknown reason)");
+  }
+  return DataFrame();
+}
+
+// [[Rcpp::export]]
+NumericMatrix ppmiSvd(const std::vector<int>& i,
+                      const std::vector<int>& j,
+                      const std::vector<double>& x,
+                      const int nConcepts,
+                      const int vectorSize,
+                      const double shift,
+                      const double contextSmoothing,
+                      const int powerIterations,
+                      const int maxCores,
+                      const int seed) {
+  
+  using namespace ohdsi::glovehd;
+  
+  try {
+    PpmiSvd ppmiSvd(i, j, x, nConcepts, vectorSize, shift, contextSmoothing, powerIterations, maxCores, seed);
+    NumericMatrix vectors = ppmiSvd.computeVectors();
+    return vectors;
+  } catch (std::exception &e) {
+    forward_exception_to_r(e);
+  } catch (...) {
+    ::Rf_error("c++ exception (unknown reason)");
+  }
+  return NumericMatrix();
+}
+
+// [[Rcpp::export]]
+S4 projectMatrix(const std::vector<int>& i,
+                 const std::vector<int>& j,
+                 const std::vector<double>& x,
+                 const std::vector<double>& baseConceptIds,
+                 const std::vector<double>& conceptIds,
+                 const DataFrame& conceptAncestor,
+                 const int maxCores) {
+  
+  using namespace ohdsi::glovehd;
+  
+  try {
+    AncestorProjector ancestorProjector(i, j, x, baseConceptIds, conceptIds, conceptAncestor, maxCores);
+    S4 matrix = ancestorProjector.projectMatrix();
+    return matrix;
+  } catch (std::exception &e) {
+    forward_exception_to_r(e);
+  } catch (...) {
+    ::Rf_error("c++ exception (unknown reason)");
+  }
+  return R_NilValue;
+}
+
 #endif // __RcppWrapper_cpp__
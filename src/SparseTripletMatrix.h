@@ -49,6 +49,11 @@ public:
     // simply add our increment
     this->sparse_container[make_pair(i, j)] += increment;
   };
+  // add all elements of another matrix with the same dimensions
+  void merge(const SparseTripletMatrix<T> &other) {
+    for(auto it : other.sparse_container)
+      this->sparse_container[it.first] += it.second;
+  };
   
   S4 get_sparse_triplet_matrix(CharacterVector  &rownames, CharacterVector  &colnames);
 private:
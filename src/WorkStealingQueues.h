@@ -0,0 +1,72 @@
+/*
+ * This file is part of GloVeHd
+ *
+ * Copyright 2023 Observational Health Data Sciences and Informatics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WORKSTEALINGQUEUES_H_
+#define WORKSTEALINGQUEUES_H_
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace ohdsi {
+namespace glovehd {
+
+// One task queue per worker. A worker takes tasks from the back of its own 
+// queue, and when that is empty steals from the front of the other queues. All
+// tasks are pushed before the workers start, so a worker is done as soon as 
+// next() returns false.
+template<typename T>
+class WorkStealingQueues {
+public:
+  WorkStealingQueues(const int _nQueues) :
+  queues(_nQueues),
+  mutexes(_nQueues) {}
+  
+  void push(const int queue, const T& task) {
+    std::lock_guard<std::mutex> lock(mutexes[queue]);
+    queues[queue].push_back(task);
+  }
+  
+  bool next(const int queue, T& task) {
+    {
+      std::lock_guard<std::mutex> lock(mutexes[queue]);
+      if (!queues[queue].empty()) {
+        task = queues[queue].back();
+        queues[queue].pop_back();
+        return true;
+      }
+    }
+    for (size_t i = 1; i < queues.size(); i++) {
+      size_t victim = (queue + i) % queues.size();
+      std::lock_guard<std::mutex> lock(mutexes[victim]);
+      if (!queues[victim].empty()) {
+        task = queues[victim].front();
+        queues[victim].pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+private:
+  std::vector<std::deque<T>> queues;
+  std::vector<std::mutex> mutexes;
+};
+}
+}
+
+#endif /* WORKSTEALINGQUEUES_H_ */